@@ -1,13 +1,84 @@
 #include "arena.h"
 
 #include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h> 
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
 
 #define UNLIKELY(x) __builtin_expect(x, 0)
 #define LIKELY(x) __builtin_expect(x, 1)
 
+#ifdef ARENA_DEBUG
+#   ifndef ARENA_REDZONE_SIZE
+#       define ARENA_REDZONE_SIZE 32
+#   endif
+
+#   if defined(__has_feature)
+#       if __has_feature(address_sanitizer)
+#           define ARENA_ASAN
+#       endif
+#   endif
+
+#   if defined(__SANITIZE_ADDRESS__) && !defined(ARENA_ASAN)
+#       define ARENA_ASAN
+#   endif
+#else
+#   undef ARENA_REDZONE_SIZE
+#   undef ARENA_GUARD_PAGES
+#   undef ARENA_FILL_PATTERN
+#endif
+
+#ifdef ARENA_ASAN
+#include <sanitizer/asan_interface.h>
+#define ARENA_POISON(ptr, size) ASAN_POISON_MEMORY_REGION(ptr, size)
+#define ARENA_UNPOISON(ptr, size) ASAN_UNPOISON_MEMORY_REGION(ptr, size)
+#else
+#define ARENA_POISON(ptr, size) ((void) (ptr), (void) (size))
+#define ARENA_UNPOISON(ptr, size) ((void) (ptr), (void) (size))
+#endif
+
+// Without ASan nothing would notice a redzone being written, so they carry a canary instead.
+// The allocation size sits at the end of each redzone so a block can be walked back from usage
+#if defined(ARENA_DEBUG) && !defined(ARENA_ASAN) && ARENA_REDZONE_SIZE > 0
+#   define ARENA_CANARY
+#   ifndef ARENA_CANARY_BYTE
+#       define ARENA_CANARY_BYTE 0xCA
+#   endif
+_Static_assert(ARENA_REDZONE_SIZE > sizeof(size_t), "canary redzones need room for the allocation size");
+#endif
+
+// Restored snapshots hold redzones laid out by another arena, their first walk is skipped
+#define ARENA_BLOCK_RESTORED ((size_t) 1)
+
+#ifdef ARENA_FILL_PATTERN
+#define ARENA_FILL(ptr, size) memset(ptr, ARENA_FILL_PATTERN, size)
+#else
+#define ARENA_FILL(ptr, size) ((void) (ptr), (void) (size))
+#endif
+
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED 1
+#endif
+
+#ifndef MPOL_BIND
+#define MPOL_BIND 2
+#endif
+
+#define ARENA_NUMA_MAX_NODES 1024
+
+// Internal option bit, numa_node is only a preference that the kernel may fall back from
+#define ARENA_NUMA_PREFERRED (1u << 31)
+
 extern void* arena_realloc_avx2(ArenaAllocator* arena, void* ptr, const size_t old_size, const size_t new_size);
 extern void* arena_memcpy_avx2(void* dest, const void* src, size_t len);
 extern void* arena_memset_avx2(void* ptr, int const value, size_t len);
@@ -50,41 +121,370 @@ inline size_t align_size(const size_t size) {
     return (size + 31) & ~(31);
 }
 
+// One long lived helper per arena, woken whenever the arena takes its spare block
+struct ArenaPreallocator {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    int requested;
+    int stopping;
+    int follow_thread;
+    ArenaOptions options;
+    size_t default_capacity;
+    ArenaBlock* block;
+};
+
+#define NUMA_WORD_BITS (8 * sizeof(unsigned long))
+
+static unsigned long numa_online_mask[ARENA_NUMA_MAX_NODES / NUMA_WORD_BITS];
+static int numa_online_count = 0;
+static pthread_once_t numa_once = PTHREAD_ONCE_INIT;
+
+// Node ids can be sparse, so read the online list ("0-1,4,6-7") rather than probing nodeN
+static void read_online_nodes(void) {
+    FILE* file = fopen("/sys/devices/system/node/online", "r");
+    if (!file) {
+        return;
+    }
+
+    int first;
+    while (fscanf(file, "%d", &first) == 1) {
+        int last = first;
+        int separator = fgetc(file);
+
+        if (separator == '-') {
+            if (fscanf(file, "%d", &last) != 1) {
+                break;
+            }
+            separator = fgetc(file);
+        }
+
+        for (int node = first < 0 ? 0 : first; node <= last && node < ARENA_NUMA_MAX_NODES; node++) {
+            numa_online_mask[node / NUMA_WORD_BITS] |= 1UL << (node % NUMA_WORD_BITS);
+            numa_online_count++;
+        }
+
+        if (separator != ',') {
+            break;
+        }
+    }
+
+    fclose(file);
+}
+
+// Binding only means something when there is more than one node to choose from
+static int numa_node_usable(const int node) {
+    pthread_once(&numa_once, read_online_nodes);
+
+    return numa_online_count > 1 && node >= 0 && node < ARENA_NUMA_MAX_NODES &&
+           (numa_online_mask[node / NUMA_WORD_BITS] >> (node % NUMA_WORD_BITS)) & 1;
+}
+
+static int current_numa_node(void) {
+#ifdef SYS_getcpu
+    unsigned cpu = 0;
+    unsigned node = 0;
+
+    if (syscall(SYS_getcpu, &cpu, &node, NULL) == 0) {
+        return (int) node;
+    }
+#endif
+
+    return ARENA_NUMA_ANY;
+}
+
+static void bind_numa_node(void* ptr, const size_t size, const int node, const int mode) {
+#ifdef SYS_mbind
+    unsigned long mask[ARENA_NUMA_MAX_NODES / NUMA_WORD_BITS] = {0};
+    mask[node / NUMA_WORD_BITS] = 1UL << (node % NUMA_WORD_BITS);
+
+    // Failure just leaves the pages to first touch, which is what we'd get without binding
+    (void) syscall(SYS_mbind, ptr, size, mode, mask, ARENA_NUMA_MAX_NODES, 0);
+#else
+    (void) ptr;
+    (void) size;
+    (void) node;
+    (void) mode;
+#endif
+}
+
 void init_arena(ArenaAllocator* arena, const size_t default_capacity) {
+    const ArenaOptions options = { .numa_node = ARENA_NUMA_ANY, .flags = 0 };
+    init_arena_with_options(arena, default_capacity, &options);
+}
+
+void init_arena_with_options(ArenaAllocator* arena, const size_t default_capacity, const ArenaOptions* options) {
     assert(arena);
+    assert(options);
     arena -> start = NULL;
     arena -> end = NULL;
     arena -> default_capacity = default_capacity == 0 ? ARENA_DEFAULT_CAPACITY : align_size(default_capacity);
+    arena -> options = *options;
+    arena -> preallocator = NULL;
+
+    arena -> options.flags &= ~ARENA_NUMA_PREFERRED;
+
+    // Plain arenas never look at the node list, it's only loaded once a binding is asked for
+    int node = options -> numa_node;
+    if (node == ARENA_NUMA_LOCAL) {
+        node = current_numa_node();
+    }
+
+    arena -> options.numa_node = node >= 0 && numa_node_usable(node) ? node : ARENA_NUMA_ANY;
 }
 
-static ArenaBlock* new_block(size_t default_capacity, size_t size) {
-    size_t capacity = default_capacity;
+static ArenaBlock* map_block(const ArenaOptions* options, const size_t bytes, const size_t guard_size) {
+    const size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    const size_t mapped_size = (sizeof(ArenaBlock) + bytes + page - 1) & ~(page - 1);
+    const int node = options -> numa_node;
+    const int prefault = (options -> flags & ARENA_PREFAULT) != 0;
 
-    while (UNLIKELY(size > capacity * sizeof(uintptr_t))) {
-        capacity *= 2;
+    // Populating before mbind would fault the pages in wherever we're running
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    if (prefault && node < 0) {
+        flags |= MAP_POPULATE;
+    }
+
+    char* base = (char*) mmap(NULL, mapped_size + guard_size, PROT_READ | PROT_WRITE, flags, -1, 0);
+    assert(base != MAP_FAILED);
+
+    if (guard_size) {
+        const int protected = mprotect(base + mapped_size, guard_size, PROT_NONE);
+        assert(protected == 0);
+        (void) protected;
     }
 
-    const size_t bytes = capacity * sizeof(uintptr_t);
-    const size_t total_size = sizeof(ArenaBlock) + bytes;
-    const size_t aligned_size = align_size(total_size);
-    ArenaBlock* block = (ArenaBlock*) aligned_alloc(32, aligned_size);
-    assert(block);
+    if (node >= 0) {
+        bind_numa_node(base, mapped_size, node, (options -> flags & ARENA_NUMA_PREFERRED) ? MPOL_PREFERRED : MPOL_BIND);
+
+        if (prefault) {
+            for (size_t offset = 0; offset < mapped_size; offset += page) {
+                ((volatile char*) base)[offset] = 0;
+            }
+        }
+    }
+
+    // Round capacity up so the end of data sits right against the guard page
+    ArenaBlock* block = (ArenaBlock*) base;
+    block -> capacity = mapped_size - sizeof(ArenaBlock);
+    block -> mapped_size = mapped_size + guard_size;
+
+    return block;
+}
+
+static ArenaBlock* sized_block(const ArenaOptions* options, const size_t bytes) {
+    ArenaBlock* block;
+
+#ifdef ARENA_GUARD_PAGES
+    block = map_block(options, bytes, (size_t) sysconf(_SC_PAGESIZE));
+#else
+    if (options -> numa_node >= 0 || (options -> flags & ARENA_PREFAULT)) {
+        block = map_block(options, bytes, 0);
+    } else {
+        const size_t total_size = sizeof(ArenaBlock) + bytes;
+        const size_t aligned_size = align_size(total_size);
+        block = (ArenaBlock*) aligned_alloc(32, aligned_size);
+        assert(block);
+
+        block -> capacity = bytes;
+        block -> mapped_size = 0;
+    }
+#endif
 
     block -> next = NULL;
     block -> usage =  0;
-    block -> capacity = bytes;
+
+    ARENA_POISON(block -> data, block -> capacity);
 
     return block;
 }
 
+static ArenaBlock* new_block(const ArenaOptions* options, size_t default_capacity, size_t size) {
+    size_t capacity = default_capacity;
+
+    while (UNLIKELY(size > capacity * sizeof(uintptr_t))) {
+        capacity *= 2;
+    }
+
+    return sized_block(options, capacity * sizeof(uintptr_t));
+}
+
+#ifdef ARENA_CANARY
+static void write_canary(char* redzone, const size_t size) {
+    memset(redzone, ARENA_CANARY_BYTE, ARENA_REDZONE_SIZE - sizeof(size_t));
+    memcpy(redzone + ARENA_REDZONE_SIZE - sizeof(size_t), &size, sizeof(size_t));
+}
+
+static void check_canaries(const ArenaBlock* block) {
+    if (block -> mapped_size & ARENA_BLOCK_RESTORED) {
+        return;
+    }
+
+    const unsigned char* data = (const unsigned char*) block -> data;
+    size_t offset = block -> usage;
+
+    while (offset > 0) {
+        size_t size;
+        const unsigned char* redzone = data + offset - ARENA_REDZONE_SIZE;
+        memcpy(&size, redzone + ARENA_REDZONE_SIZE - sizeof(size_t), sizeof(size_t));
+
+        int intact = offset >= ARENA_REDZONE_SIZE && size <= offset - ARENA_REDZONE_SIZE;
+        for (size_t i = 0; intact && i < ARENA_REDZONE_SIZE - sizeof(size_t); i++) {
+            intact = redzone[i] == ARENA_CANARY_BYTE;
+        }
+
+        if (!intact) {
+            fprintf(stderr, "arena: redzone overwritten after allocation ending at %p\n", (const void*) redzone);
+            abort();
+        }
+
+        offset -= ARENA_REDZONE_SIZE + size;
+    }
+}
+#else
+#define check_canaries(block) ((void) (block))
+#endif
+
 static inline void free_block(ArenaBlock* block) {
-    free(block);
+    check_canaries(block);
+    ARENA_UNPOISON(block -> data, block -> capacity);
+    ARENA_FILL(block -> data, block -> capacity);
+
+    const size_t mapped_size = block -> mapped_size & ~ARENA_BLOCK_RESTORED;
+    if (mapped_size) {
+        munmap(block, mapped_size);
+    } else {
+        free(block);
+    }
 }
 
-void* arena_alloc(ArenaAllocator* arena, const size_t size) {
+// Re-resolved on every growth so spares move with a migrated thread
+static void follow_current_node(ArenaOptions* options) {
+    const int node = current_numa_node();
+
+    if (node >= 0 && numa_node_usable(node)) {
+        options -> numa_node = node;
+        options -> flags |= ARENA_NUMA_PREFERRED;
+    } else {
+        options -> numa_node = ARENA_NUMA_ANY;
+        options -> flags &= ~ARENA_NUMA_PREFERRED;
+    }
+}
+
+static void* run_preallocator(void* data) {
+    struct ArenaPreallocator* preallocator = (struct ArenaPreallocator*) data;
+
+    pthread_mutex_lock(&preallocator -> lock);
+
+    while (!preallocator -> stopping) {
+        if (preallocator -> requested && !preallocator -> block) {
+            preallocator -> requested = 0;
+            const ArenaOptions options = preallocator -> options;
+            pthread_mutex_unlock(&preallocator -> lock);
+
+            ArenaBlock* block = new_block(&options, preallocator -> default_capacity, 0);
+
+            pthread_mutex_lock(&preallocator -> lock);
+            preallocator -> block = block;
+            continue;
+        }
+
+        pthread_cond_wait(&preallocator -> wake, &preallocator -> lock);
+    }
+
+    pthread_mutex_unlock(&preallocator -> lock);
+    return NULL;
+}
+
+static struct ArenaPreallocator* start_preallocator(const ArenaAllocator* arena) {
+    struct ArenaPreallocator* preallocator = (struct ArenaPreallocator*) calloc(1, sizeof(struct ArenaPreallocator));
+    if (!preallocator) {
+        return NULL;
+    }
+
+    // Spares are always prefaulted, otherwise their page faults would still land on the allocating thread.
+    // The helper does that first touch, so an unbound arena's spares only prefer the growing thread's node
+    preallocator -> options = arena -> options;
+    preallocator -> options.flags |= ARENA_PREFAULT;
+    preallocator -> follow_thread = arena -> options.numa_node < 0;
+
+    preallocator -> default_capacity = arena -> default_capacity;
+    pthread_mutex_init(&preallocator -> lock, NULL);
+    pthread_cond_init(&preallocator -> wake, NULL);
+
+    if (pthread_create(&preallocator -> thread, NULL, run_preallocator, preallocator) != 0) {
+        pthread_cond_destroy(&preallocator -> wake);
+        pthread_mutex_destroy(&preallocator -> lock);
+        free(preallocator);
+        return NULL;
+    }
+
+    return preallocator;
+}
+
+static void stop_preallocator(struct ArenaPreallocator* preallocator) {
+    pthread_mutex_lock(&preallocator -> lock);
+    preallocator -> stopping = 1;
+    pthread_cond_signal(&preallocator -> wake);
+    pthread_mutex_unlock(&preallocator -> lock);
+
+    pthread_join(preallocator -> thread, NULL);
+
+    if (preallocator -> block) {
+        free_block(preallocator -> block);
+    }
+
+    pthread_cond_destroy(&preallocator -> wake);
+    pthread_mutex_destroy(&preallocator -> lock);
+    free(preallocator);
+}
+
+// Never waits on the helper, if the spare isn't ready yet we allocate the block ourselves
+static ArenaBlock* take_spare_block(struct ArenaPreallocator* preallocator, const size_t size) {
+    ArenaBlock* block = NULL;
+
+    pthread_mutex_lock(&preallocator -> lock);
+
+    if (preallocator -> follow_thread) {
+        follow_current_node(&preallocator -> options);
+    }
+
+    if (preallocator -> block && size <= preallocator -> block -> capacity) {
+        block = preallocator -> block;
+        preallocator -> block = NULL;
+    }
+
+    preallocator -> requested = 1;
+    pthread_cond_signal(&preallocator -> wake);
+    pthread_mutex_unlock(&preallocator -> lock);
+
+    return block;
+}
+
+static ArenaBlock* grow_arena(ArenaAllocator* arena, const size_t size) {
+    ArenaBlock* block = NULL;
+
+    if (arena -> options.flags & ARENA_PREALLOCATE) {
+        if (UNLIKELY(!arena -> preallocator)) {
+            arena -> preallocator = start_preallocator(arena);
+        }
+
+        if (arena -> preallocator) {
+            block = take_spare_block(arena -> preallocator, size);
+        }
+    }
+
+    if (!block) {
+        block = new_block(&arena -> options, arena -> default_capacity, size);
+    }
+
+    return block;
+}
+
+static inline void* arena_bump(ArenaAllocator* arena, const size_t size) {
     ArenaBlock* block = arena -> end;
     if (UNLIKELY(!block)) {
-        block = new_block(arena -> default_capacity, size);
+        block = grow_arena(arena, size);
         arena -> end = block;
         arena -> start = arena -> end;
     } 
@@ -105,7 +505,7 @@ void* arena_alloc(ArenaAllocator* arena, const size_t size) {
     }
 
     if (!next) {
-        next = new_block(arena -> default_capacity, size);
+        next = grow_arena(arena, size);
         block -> next = next;
     }
 
@@ -116,6 +516,20 @@ void* arena_alloc(ArenaAllocator* arena, const size_t size) {
     return result;
 }
 
+void* arena_alloc(ArenaAllocator* arena, const size_t size) {
+#ifdef ARENA_DEBUG
+    char* result = (char*) arena_bump(arena, size + ARENA_REDZONE_SIZE);
+    ARENA_UNPOISON(result, size);
+    ARENA_POISON(result + size, ARENA_REDZONE_SIZE);
+#ifdef ARENA_CANARY
+    write_canary(result + size, size);
+#endif
+    return result;
+#else
+    return arena_bump(arena, size);
+#endif
+}
+
 char* arena_strdup(ArenaAllocator* arena, const char* str) {
     const size_t len = strlen(str);
     char* duplicate = (char*) arena_alloc(arena, len + 1);
@@ -128,6 +542,13 @@ char* arena_strdup(ArenaAllocator* arena, const char* str) {
 
 inline void arena_reset(ArenaAllocator* arena) {
     for (ArenaBlock* block = arena -> start; block != NULL; block = block -> next) {
+#ifdef ARENA_DEBUG
+        check_canaries(block);
+        block -> mapped_size &= ~ARENA_BLOCK_RESTORED;
+        ARENA_UNPOISON(block -> data, block -> usage);
+        ARENA_FILL(block -> data, block -> usage);
+        ARENA_POISON(block -> data, block -> capacity);
+#endif
         block -> usage = 0;
     }
 
@@ -135,6 +556,11 @@ inline void arena_reset(ArenaAllocator* arena) {
 }
 
 void arena_free(ArenaAllocator* arena) {
+    if (arena -> preallocator) {
+        stop_preallocator(arena -> preallocator);
+        arena -> preallocator = NULL;
+    }
+
     ArenaBlock* block = arena -> start;
 
     while (block != NULL) {
@@ -147,6 +573,33 @@ void arena_free(ArenaAllocator* arena) {
     arena -> end = NULL;
 }
 
+void arena_handoff(ArenaAllocator* dest, ArenaAllocator* src) {
+    assert(dest && src && dest != src);
+
+    // Nothing allocated since the last reset, keep every block where it is
+    if (!src -> start || src -> end -> usage == 0) {
+        return;
+    }
+
+    // Blocks past end are empty after the last reset, src keeps them as its cache
+    ArenaBlock* first = src -> start;
+    ArenaBlock* last = src -> end;
+    ArenaBlock* spare = last -> next;
+
+    // Spliced in after the block dest is filling, so dest's own cache stays behind them too
+    if (!dest -> start) {
+        last -> next = NULL;
+        dest -> start = first;
+    } else {
+        last -> next = dest -> end -> next;
+        dest -> end -> next = first;
+    }
+    dest -> end = last;
+
+    src -> start = spare;
+    src -> end = spare;
+}
+
 size_t total_capacity(const ArenaAllocator* arena) {
     const ArenaBlock* current = arena -> start;
     size_t total = 0;
@@ -170,3 +623,453 @@ size_t total_usage(const ArenaAllocator* arena) {
     
     return total;
 }
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+#define ARENA_SNAPSHOT_MAGIC 0x414E455241534857ULL // "WHSARENA"
+#define ARENA_SNAPSHOT_VERSION 1
+
+// Laid over the ArenaBlock header when a snapshot is mapped back in, so the sizes must match
+typedef struct {
+    uint64_t magic;
+    uint64_t version;
+    uint64_t data_size;
+    uint64_t relocation_count;
+} ArenaSnapshotHeader;
+
+_Static_assert(sizeof(ArenaSnapshotHeader) == sizeof(ArenaBlock), "snapshot header must overlay ArenaBlock");
+
+typedef struct {
+    uintptr_t begin;
+    uintptr_t end;
+    uint64_t offset;
+} SnapshotRange;
+
+typedef struct {
+    uint64_t slot;
+    uint64_t target;
+} SnapshotRelocation;
+
+static int compare_ranges(const void* a, const void* b) {
+    const uintptr_t x = ((const SnapshotRange*) a) -> begin;
+    const uintptr_t y = ((const SnapshotRange*) b) -> begin;
+    return (x > y) - (x < y);
+}
+
+static int compare_relocations(const void* a, const void* b) {
+    const uint64_t x = ((const SnapshotRelocation*) a) -> slot;
+    const uint64_t y = ((const SnapshotRelocation*) b) -> slot;
+    return (x > y) - (x < y);
+}
+
+// Ranges are sorted by address and end is inclusive so one-past-the-end pointers still resolve
+static const SnapshotRange* find_range(const SnapshotRange* ranges, const size_t count, const uintptr_t address) {
+    size_t low = 0;
+    size_t high = count;
+
+    while (low < high) {
+        const size_t middle = low + (high - low) / 2;
+        if (ranges[middle].begin <= address) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    if (low == 0 || address > ranges[low - 1].end) {
+        return NULL;
+    }
+
+    return &ranges[low - 1];
+}
+
+static int write_all(const int fd, struct iovec* iov, size_t count) {
+    while (count > 0) {
+        const int batch = count > IOV_MAX ? IOV_MAX : (int) count;
+#ifdef ARENA_ASAN
+        // Redzones are poisoned but still part of the image, so go around the interceptor
+        ssize_t written = syscall(SYS_writev, fd, iov, batch);
+#else
+        ssize_t written = writev(fd, iov, batch);
+#endif
+
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+
+        while (count > 0 && (size_t) written >= iov -> iov_len) {
+            written -= (ssize_t) iov -> iov_len;
+            iov++;
+            count--;
+        }
+
+        if (count > 0) {
+            iov -> iov_base = (char*) iov -> iov_base + written;
+            iov -> iov_len -= (size_t) written;
+        }
+    }
+
+    return 0;
+}
+
+static int read_all(const int fd, void* buffer, size_t size, off_t offset) {
+    char* p = (char*) buffer;
+
+    while (size > 0) {
+        const ssize_t got = pread(fd, p, size, offset);
+
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (got <= 0) {
+            if (got == 0) {
+                errno = EIO;
+            }
+            return -1;
+        }
+
+        p += got;
+        size -= (size_t) got;
+        offset += got;
+    }
+
+    return 0;
+}
+
+// Turning target offsets into addresses is a contiguous add that vectorises, only the
+// stores are a scatter. Relocations are sorted by slot so those at least walk forwards
+static void apply_relocations(char* base, const uint64_t* slots, uint64_t* targets, const size_t count) {
+    const uint64_t origin = (uint64_t) (uintptr_t) base;
+
+    for (size_t i = 0; i < count; i++) {
+        targets[i] += origin;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        memcpy(base + slots[i], &targets[i], sizeof(uintptr_t));
+    }
+}
+
+static int check_relocations(const uint64_t* slots, const uint64_t* targets, const size_t count, const uint64_t data_size) {
+    for (size_t i = 0; i < count; i++) {
+        if (data_size < sizeof(uintptr_t) || slots[i] > data_size - sizeof(uintptr_t) || targets[i] > data_size) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static void append_block(ArenaAllocator* arena, ArenaBlock* block) {
+    if (!arena -> start) {
+        arena -> start = block;
+    } else {
+        ArenaBlock* tail = arena -> start;
+        while (tail -> next) {
+            tail = tail -> next;
+        }
+        tail -> next = block;
+    }
+
+    arena -> end = block;
+}
+
+// The rename itself only survives a crash once the directory holding it is synced
+static int sync_parent_directory(const char* path) {
+    const char* slash = strrchr(path, '/');
+    char* directory;
+
+    if (!slash) {
+        directory = strdup(".");
+    } else if (slash == path) {
+        directory = strdup("/");
+    } else {
+        directory = strndup(path, (size_t) (slash - path));
+    }
+
+    if (!directory) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    const int fd = open(directory, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    free(directory);
+
+    if (fd < 0) {
+        return -1;
+    }
+
+    const int result = fsync(fd);
+    close(fd);
+
+    return result == 0 ? 0 : -1;
+}
+
+int arena_snapshot(const ArenaAllocator* arena, const char* path, void** const* slots, const size_t slot_count) {
+    static const char padding[32] = {0};
+
+    size_t block_count = 0;
+    for (const ArenaBlock* block = arena -> start; block != NULL; block = block -> next) {
+        block_count++;
+    }
+
+    SnapshotRange* ranges = (SnapshotRange*) malloc((block_count + 1) * sizeof(SnapshotRange));
+    SnapshotRelocation* relocations = (SnapshotRelocation*) malloc((slot_count + 1) * sizeof(SnapshotRelocation));
+    uint64_t* table = (uint64_t*) malloc((2 * slot_count + 1) * sizeof(uint64_t));
+    struct iovec* iov = (struct iovec*) malloc((2 * block_count + 3) * sizeof(struct iovec));
+
+    // Written to a unique file beside the old snapshot and renamed over it, so neither a failed write
+    // nor a concurrent snapshot to the same path can lose the last good one
+    const size_t path_length = strlen(path);
+    char* temp_path = (char*) malloc(path_length + sizeof(".XXXXXX"));
+
+    int result = -1;
+    int fd = -1;
+
+    if (!ranges || !relocations || !table || !iov || !temp_path) {
+        errno = ENOMEM;
+        goto done;
+    }
+
+    // Blocks are padded to 32 bytes in the image so allocations keep their alignment
+    ArenaSnapshotHeader header = { ARENA_SNAPSHOT_MAGIC, ARENA_SNAPSHOT_VERSION, 0, 0 };
+    size_t iov_count = 1;
+    size_t range_count = 0;
+
+    iov[0].iov_base = &header;
+    iov[0].iov_len = sizeof(header);
+
+    for (const ArenaBlock* block = arena -> start; block != NULL; block = block -> next) {
+        if (block -> usage == 0) {
+            continue;
+        }
+
+        ranges[range_count].begin = (uintptr_t) block -> data;
+        ranges[range_count].end = (uintptr_t) block -> data + block -> usage;
+        ranges[range_count].offset = header.data_size;
+        range_count++;
+
+        iov[iov_count].iov_base = (void*) block -> data;
+        iov[iov_count].iov_len = block -> usage;
+        iov_count++;
+
+        const size_t padded = align_size(block -> usage);
+        if (padded != block -> usage) {
+            iov[iov_count].iov_base = (void*) padding;
+            iov[iov_count].iov_len = padded - block -> usage;
+            iov_count++;
+        }
+
+        header.data_size += padded;
+    }
+
+    qsort(ranges, range_count, sizeof(SnapshotRange), compare_ranges);
+
+    for (size_t i = 0; i < slot_count; i++) {
+        const uintptr_t slot = (uintptr_t) slots[i];
+        const uintptr_t target = (uintptr_t) *slots[i];
+
+        // Null stays null, the image already holds a zero there
+        if (!target) {
+            continue;
+        }
+
+        const SnapshotRange* slot_range = find_range(ranges, range_count, slot);
+        const SnapshotRange* target_range = find_range(ranges, range_count, target);
+
+        if (!slot_range || !target_range || slot + sizeof(uintptr_t) > slot_range -> end) {
+            errno = EINVAL;
+            goto done;
+        }
+
+        relocations[header.relocation_count].slot = slot_range -> offset + (slot - slot_range -> begin);
+        relocations[header.relocation_count].target = target_range -> offset + (target - target_range -> begin);
+        header.relocation_count++;
+    }
+
+    qsort(relocations, header.relocation_count, sizeof(SnapshotRelocation), compare_relocations);
+
+    const size_t relocation_count = header.relocation_count;
+    for (size_t i = 0; i < relocation_count; i++) {
+        table[i] = relocations[i].slot;
+        table[relocation_count + i] = relocations[i].target;
+    }
+
+    iov[iov_count].iov_base = table;
+    iov[iov_count].iov_len = 2 * relocation_count * sizeof(uint64_t);
+    iov_count++;
+
+    memcpy(temp_path, path, path_length);
+    memcpy(temp_path + path_length, ".XXXXXX", sizeof(".XXXXXX"));
+
+    fd = mkstemp(temp_path);
+    if (fd < 0) {
+        goto done;
+    }
+
+    // mkstemp creates the file 0600, snapshots are shared like any other output file
+    result = fcntl(fd, F_SETFD, FD_CLOEXEC) == 0 && fchmod(fd, 0644) == 0 ? 0 : -1;
+    if (result == 0) {
+        result = write_all(fd, iov, iov_count);
+    }
+    if (result == 0 && fsync(fd) != 0) {
+        result = -1;
+    }
+
+done:
+    if (fd >= 0) {
+        if (close(fd) != 0) {
+            result = -1;
+        }
+
+        if (result == 0 && rename(temp_path, path) != 0) {
+            result = -1;
+        }
+
+        if (result != 0) {
+            const int error = errno;
+            unlink(temp_path);
+            errno = error;
+        } else {
+            result = sync_parent_directory(path);
+        }
+    }
+
+    free(temp_path);
+    free(ranges);
+    free(relocations);
+    free(table);
+    free(iov);
+
+    return result;
+}
+
+static int read_snapshot_header(const int fd, ArenaSnapshotHeader* header, size_t* file_size) {
+    struct stat info;
+
+    if (fstat(fd, &info) != 0 || read_all(fd, header, sizeof(*header), 0) != 0) {
+        return -1;
+    }
+
+    const uint64_t size = (uint64_t) info.st_size;
+    const uint64_t data_end = sizeof(*header) + header -> data_size;
+
+    if (header -> magic != ARENA_SNAPSHOT_MAGIC || header -> version != ARENA_SNAPSHOT_VERSION ||
+        header -> data_size > size || header -> relocation_count > size / (2 * sizeof(uint64_t)) ||
+        data_end + 2 * header -> relocation_count * sizeof(uint64_t) != size) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    *file_size = (size_t) size;
+    return 0;
+}
+
+void* arena_restore(ArenaAllocator* arena, const char* path) {
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    ArenaSnapshotHeader header;
+    size_t file_size;
+    uint64_t* table = NULL;
+    ArenaBlock* block = NULL;
+
+    if (read_snapshot_header(fd, &header, &file_size) != 0) {
+        goto fail;
+    }
+
+    const size_t table_size = 2 * header.relocation_count * sizeof(uint64_t);
+    table = (uint64_t*) malloc(table_size + 1);
+    if (!table) {
+        errno = ENOMEM;
+        goto fail;
+    }
+
+    if (read_all(fd, table, table_size, (off_t) (sizeof(header) + header.data_size)) != 0) {
+        goto fail;
+    }
+
+    if (!check_relocations(table, table + header.relocation_count, header.relocation_count, header.data_size)) {
+        errno = EINVAL;
+        goto fail;
+    }
+
+    block = sized_block(&arena -> options, header.data_size);
+    ARENA_UNPOISON(block -> data, header.data_size);
+
+    if (read_all(fd, block -> data, header.data_size, sizeof(header)) != 0) {
+        goto fail;
+    }
+
+    apply_relocations((char*) block -> data, table, table + header.relocation_count, header.relocation_count);
+    block -> usage = header.data_size;
+    block -> mapped_size |= ARENA_BLOCK_RESTORED;
+
+    close(fd);
+    free(table);
+    append_block(arena, block);
+
+    return block -> data;
+
+fail:
+    close(fd);
+    free(table);
+
+    if (block) {
+        free_block(block);
+    }
+
+    return NULL;
+}
+
+void* arena_restore_mapped(ArenaAllocator* arena, const char* path) {
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    ArenaSnapshotHeader header;
+    size_t file_size;
+
+    if (read_snapshot_header(fd, &header, &file_size) != 0) {
+        close(fd);
+        return NULL;
+    }
+
+    // Private mapping, so the header is overwritten and pointers fixed up in copy-on-write pages
+    char* base = (char*) mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+
+    if (base == MAP_FAILED) {
+        return NULL;
+    }
+
+    const uint64_t* slots = (const uint64_t*) (base + sizeof(header) + header.data_size);
+    uint64_t* targets = (uint64_t*) slots + header.relocation_count;
+
+    if (!check_relocations(slots, targets, header.relocation_count, header.data_size)) {
+        munmap(base, file_size);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    ArenaBlock* block = (ArenaBlock*) base;
+    apply_relocations((char*) block -> data, slots, targets, header.relocation_count);
+
+    block -> next = NULL;
+    block -> usage = header.data_size;
+    block -> capacity = header.data_size;
+    block -> mapped_size = file_size | ARENA_BLOCK_RESTORED;
+
+    append_block(arena, block);
+
+    return block -> data;
+}
@@ -0,0 +1,84 @@
+#include "arena.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#define UNLIKELY(x) __builtin_expect(x, 0)
+#define LIKELY(x) __builtin_expect(x, 1)
+
+static pthread_key_t thread_arena_key;
+static pthread_once_t thread_arena_once = PTHREAD_ONCE_INIT;
+
+// Configuration is read once per thread on creation, so a plain mutex is cheap enough
+static pthread_mutex_t thread_arena_config_lock = PTHREAD_MUTEX_INITIALIZER;
+static size_t thread_arena_capacity = 0;
+static ArenaOptions thread_arena_options = { .numa_node = ARENA_NUMA_ANY, .flags = 0 };
+
+// Mirrors the key so the hot path is a single TLS load, the key only exists for its destructor
+static __thread ArenaAllocator* thread_arena = NULL;
+
+static void destroy_thread_arena(void* data) {
+    ArenaAllocator* arena = (ArenaAllocator*) data;
+
+    // A later key destructor on this thread may still ask for an arena, it then gets a fresh one
+    // and glibc runs this again for it, up to PTHREAD_DESTRUCTOR_ITERATIONS
+    thread_arena = NULL;
+
+    arena_free(arena);
+    free(arena);
+}
+
+static void create_thread_arena_key(void) {
+    const int created = pthread_key_create(&thread_arena_key, destroy_thread_arena);
+    assert(created == 0);
+    (void) created;
+}
+
+void arena_thread_configure(const size_t default_capacity, const ArenaOptions* options) {
+    pthread_mutex_lock(&thread_arena_config_lock);
+    thread_arena_capacity = default_capacity;
+
+    if (options) {
+        thread_arena_options = *options;
+    }
+    pthread_mutex_unlock(&thread_arena_config_lock);
+}
+
+static ArenaAllocator* create_thread_arena(void) {
+    pthread_once(&thread_arena_once, create_thread_arena_key);
+
+    ArenaAllocator* arena = (ArenaAllocator*) malloc(sizeof(ArenaAllocator));
+    assert(arena);
+
+    pthread_mutex_lock(&thread_arena_config_lock);
+    const size_t capacity = thread_arena_capacity;
+    const ArenaOptions options = thread_arena_options;
+    pthread_mutex_unlock(&thread_arena_config_lock);
+
+    // Resolved here rather than at configure time so ARENA_NUMA_LOCAL means this thread's node
+    init_arena_with_options(arena, capacity, &options);
+
+    const int stored = pthread_setspecific(thread_arena_key, arena);
+    assert(stored == 0);
+    (void) stored;
+
+    thread_arena = arena;
+    return arena;
+}
+
+ArenaAllocator* arena_thread_local(void) {
+    ArenaAllocator* arena = thread_arena;
+
+    if (UNLIKELY(!arena)) {
+        arena = create_thread_arena();
+    }
+
+    return arena;
+}
+
+ArenaAllocator* arena_thread_begin(void) {
+    ArenaAllocator* arena = arena_thread_local();
+    arena_reset(arena);
+    return arena;
+}
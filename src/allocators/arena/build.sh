@@ -2,9 +2,14 @@
 
 mkdir -p build/bin/
 
-clang -O3 -c arena.c -o build/arena.o
-clang -O3 -mavx2 -c arena_avx2.c -o build/arena_avx2.o
-clang -O3 -msse2 -c arena_sse2.c -o build/arena_sse2.o
-# clang -O3 -c arena_generic.c -o arena_generic.o
+# Debug build: CFLAGS="-O1 -g -fsanitize=address -DARENA_DEBUG -DARENA_GUARD_PAGES -DARENA_FILL_PATTERN=0xDD" ./build.sh
+CC=${CC:-clang}
+CFLAGS=${CFLAGS:--O3}
 
-ar rcs build/bin/libarena.a build/arena.o build/arena_avx2.o build/arena_sse2.o
+$CC $CFLAGS -c arena.c -o build/arena.o
+$CC $CFLAGS -c arena_thread.c -o build/arena_thread.o
+$CC $CFLAGS -mavx2 -c arena_avx2.c -o build/arena_avx2.o
+$CC $CFLAGS -msse2 -c arena_sse2.c -o build/arena_sse2.o
+# $CC $CFLAGS -c arena_generic.c -o arena_generic.o
+
+ar rcs build/bin/libarena.a build/arena.o build/arena_thread.o build/arena_avx2.o build/arena_sse2.o
@@ -1,7 +1,41 @@
 #!/usr/bin/env bash
 
+set -e
+
+CC=${CC:-clang}
+CXX=${CXX:-clang++}
+CFLAGS=${CFLAGS:--Weverything}
+ARENA_SRC=../../src/allocators/arena
+
 mkdir -p build/bin/
 
-clang -Weverything src/main.c lib/libarena.a -o build/bin/main
+$CC $CFLAGS src/main.c lib/libarena.a -pthread -o build/bin/main
+
+$CXX $CFLAGS -std=c++17 src/inline.cpp lib/libarena.a -pthread -o build/bin/inline
 
 ./build/bin/main
+./build/bin/inline
+
+# Debug mode only exists when the library itself is built with it, so build it from source under ASan
+DEBUG_FLAGS="-g -fsanitize=address -DARENA_DEBUG -DARENA_GUARD_PAGES -DARENA_FILL_PATTERN=0xDD"
+
+$CC $DEBUG_FLAGS -c $ARENA_SRC/arena.c -o build/arena_debug.o
+$CC $DEBUG_FLAGS -c $ARENA_SRC/arena_thread.c -o build/arena_thread_debug.o
+$CC $DEBUG_FLAGS -mavx2 -c $ARENA_SRC/arena_avx2.c -o build/arena_avx2_debug.o
+$CC $DEBUG_FLAGS -msse2 -c $ARENA_SRC/arena_sse2.c -o build/arena_sse2_debug.o
+$CC $CFLAGS $DEBUG_FLAGS src/debug.c build/arena_debug.o build/arena_thread_debug.o build/arena_avx2_debug.o build/arena_sse2_debug.o -pthread -o build/bin/debug
+$CXX $CFLAGS $DEBUG_FLAGS -std=c++17 src/inline.cpp build/arena_debug.o build/arena_thread_debug.o build/arena_avx2_debug.o build/arena_sse2_debug.o -pthread -o build/bin/inline_debug
+
+./build/bin/debug
+./build/bin/inline_debug
+
+# Without ASan redzones fall back to canaries, which need a debug build of their own
+CANARY_FLAGS="-g -DARENA_DEBUG"
+
+$CC $CANARY_FLAGS -c $ARENA_SRC/arena.c -o build/arena_canary.o
+$CC $CANARY_FLAGS -c $ARENA_SRC/arena_thread.c -o build/arena_thread_canary.o
+$CC $CANARY_FLAGS -mavx2 -c $ARENA_SRC/arena_avx2.c -o build/arena_avx2_canary.o
+$CC $CANARY_FLAGS -msse2 -c $ARENA_SRC/arena_sse2.c -o build/arena_sse2_canary.o
+$CC $CFLAGS $CANARY_FLAGS src/canary.c build/arena_canary.o build/arena_thread_canary.o build/arena_avx2_canary.o build/arena_sse2_canary.o -pthread -o build/bin/canary
+
+./build/bin/canary
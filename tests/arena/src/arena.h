@@ -7,12 +7,52 @@
  *
  *      #include "arena.h"
  *
- *      Add arena.c to compilation, with -mavx2 for AVX2 support
+ *      Add arena.c to compilation, with -mavx2 for AVX2 support, and link with -pthread
  *
  *      Use init_arena() to initialise your arena: 
  *          The size is multiplied by sizeof(uintptr_t)
  *          Pass in 0 for default capacity of 4 * 1024 * sizeof(uintptr_t) = 32768 bytes on 64 bit
  *
+ *      Use init_arena_with_options() for placement control on Linux:
+ *          .numa_node          node to mbind blocks to, ARENA_NUMA_LOCAL for the calling thread's node
+ *                              or ARENA_NUMA_ANY for first touch. Ignored on single node systems
+ *          ARENA_PREFAULT      fault every page of a block in when it is created
+ *          ARENA_PREALLOCATE   keep a prefaulted spare block ready on a helper thread for the next growth
+ *                              Spares of an unbound arena prefer, but are not bound to, the growing thread's node
+ *
+ *      Snapshots, arena_snapshot() writes every block and a relocation table in one writev:
+ *          slots lists the addresses of pointer fields inside the arena that point back into it
+ *          arena_restore() reads the image into one block, arena_restore_mapped() maps it privately
+ *          Both fix the recorded pointers up and return the start of the image, which is where
+ *          the first allocation made in the snapshotted arena now lives
+ *
+ *      Per-thread scratch arenas, add arena_thread.c to compilation:
+ *          arena_thread_local() lazily creates the calling thread's arena, freed when the thread exits
+ *          arena_thread_begin() resets it for the next task and keeps its blocks around
+ *          arena_thread_configure() sets capacity and options for arenas created after the call
+ *
+ *          arena_handoff(dest, src) moves the blocks src has allocated from since its last reset into dest
+ *          without copying. src keeps its remaining empty blocks for reuse, dest keeps its own after the moved ones.
+ *          Pass results between threads by handing off into a plain arena:
+ *
+ *              ArenaAllocator result;
+ *              init_arena(&result, 0);
+ *              arena_handoff(&result, arena_thread_local());
+ *
+ *      Debug mode, compile arena.c with -DARENA_DEBUG (and ideally -fsanitize=address):
+ *          Unused, reset and redzone memory is poisoned when built under ASan
+ *          Without ASan redzones hold a canary that is checked on reset and free, aborting if overwritten
+ *          -DARENA_REDZONE_SIZE=n   poisoned bytes placed after each allocation, defaults to 32
+ *                                   must exceed sizeof(size_t) without ASan, the size is kept in the redzone
+ *          -DARENA_CANARY_BYTE=b    canary written into redzones without ASan, defaults to 0xCA
+ *          -DARENA_GUARD_PAGES      mmap each block with a PROT_NONE page directly behind it
+ *          -DARENA_FILL_PATTERN=b   byte written over memory on reset and free, e.g. 0xDD
+ *
+ *          None of these have any effect without ARENA_DEBUG
+ *
+ *          Snapshots keep redzones as plain bytes. Restored images are unpoisoned as a whole and
+ *          their canaries go unchecked, so restored objects get no overflow detection
+ *
  */
 
 #ifndef ARENA_H
@@ -23,7 +63,7 @@ extern "C" {
 #endif
 
 #include <stdint.h>
-#include <stdlib.h>
+#include <stddef.h>
 
 #define ARENA_DEFAULT_CAPACITY (4 * 1024) 
 
@@ -33,10 +73,24 @@ extern "C" {
 #define arena_array_zero(arena, type, count) \
     (type*) arena_memset(arena_alloc(arena, sizeof(type) * (count)), 0, sizeof(type) * (count)) 
 
+#define ARENA_NUMA_ANY (-1)
+#define ARENA_NUMA_LOCAL (-2)
+
+typedef enum {
+    ARENA_PREFAULT    = 1 << 0,
+    ARENA_PREALLOCATE = 1 << 1,
+} ArenaFlags;
+
+typedef struct {
+    int numa_node;
+    unsigned flags;
+} ArenaOptions;
+
 typedef struct ArenaBlock {
     struct ArenaBlock* next;
     size_t usage;
     size_t capacity;
+    size_t mapped_size;
     uintptr_t data[];
 } ArenaBlock;
 
@@ -44,23 +98,36 @@ typedef struct {
     ArenaBlock* start;
     ArenaBlock* end;
     size_t default_capacity;
+    ArenaOptions options;
+    struct ArenaPreallocator* preallocator;
 } ArenaAllocator;
 
 size_t align_size(size_t size);
 
 void init_arena(ArenaAllocator* arena, size_t default_capacity);
+void init_arena_with_options(ArenaAllocator* arena, size_t default_capacity, const ArenaOptions* options);
 
-void* arena_alloc(ArenaAllocator* arena, size_t size);
-void* arena_realloc(ArenaAllocator* arena, void* ptr, size_t old_size, size_t new_size);
-void* arena_memset(void* ptr, int value, size_t len);
+void* arena_alloc(ArenaAllocator* arena, const size_t size);
+void* arena_realloc(ArenaAllocator* arena, void* ptr, const size_t old_size, const size_t new_size);
+void* arena_memset(void* ptr, const int value, size_t len);
 void* arena_memcpy(void* dest, const void* src, size_t len);
 char* arena_strdup(ArenaAllocator* arena, const char* str);
 
+int arena_snapshot(const ArenaAllocator* arena, const char* path, void** const* slots, size_t slot_count);
+void* arena_restore(ArenaAllocator* arena, const char* path);
+void* arena_restore_mapped(ArenaAllocator* arena, const char* path);
+
+void arena_handoff(ArenaAllocator* dest, ArenaAllocator* src);
+
+void arena_thread_configure(size_t default_capacity, const ArenaOptions* options);
+ArenaAllocator* arena_thread_local(void);
+ArenaAllocator* arena_thread_begin(void);
+
 void arena_reset(ArenaAllocator* arena);
 void arena_free(ArenaAllocator* arena); 
 
-size_t total_capacity(ArenaAllocator* arena);
-size_t total_usage(ArenaAllocator* arena); 
+size_t total_capacity(const ArenaAllocator* arena);
+size_t total_usage(const ArenaAllocator* arena); 
 
 #ifdef __cplusplus 
 }
@@ -0,0 +1,197 @@
+/*
+ *
+ *  Usage:
+ *
+ *      #include "arena.hpp"
+ *
+ *      Header only, C++17. Link against libarena.a as for arena.h
+ *
+ *      InlineArena<Bytes, Align> keeps its first Bytes of storage inside the object itself:
+ *          Put one on the stack or in a struct, no allocation happens until it overflows
+ *          Overflow is served by a regular ArenaAllocator, which is only touched on that path
+ *          Align must be a power of two and is applied to every allocation
+ *          alloc<N>() and make<T>() round their size at compile time, alloc(size) and make_array<T>(count)
+ *          round at runtime and return nullptr if the size overflows
+ *
+ *          InlineArena<4096> scratch;
+ *          Node* node = scratch.make<Node>(key, value);
+ *          int* items = scratch.make_array<int>(count);
+ *
+ *      Destructors are never run, so make<T> only accepts trivially destructible types
+ *
+ *      Define ARENA_DEBUG here too when linking a debug libarena.a. Under ASan the inline storage is then
+ *      poisoned until handed out and again on reset, but it gets no redzones, guard pages or fill pattern
+ *
+ */
+
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include "arena.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#if defined(ARENA_DEBUG) && defined(__has_feature)
+#   if __has_feature(address_sanitizer)
+#       define ARENA_HPP_ASAN
+#   endif
+#endif
+
+#if defined(ARENA_DEBUG) && defined(__SANITIZE_ADDRESS__) && !defined(ARENA_HPP_ASAN)
+#   define ARENA_HPP_ASAN
+#endif
+
+#ifdef ARENA_HPP_ASAN
+#include <sanitizer/asan_interface.h>
+#define ARENA_HPP_POISON(ptr, size) ASAN_POISON_MEMORY_REGION(ptr, size)
+#define ARENA_HPP_UNPOISON(ptr, size) ASAN_UNPOISON_MEMORY_REGION(ptr, size)
+#else
+#define ARENA_HPP_POISON(ptr, size) (static_cast<void>(ptr), static_cast<void>(size))
+#define ARENA_HPP_UNPOISON(ptr, size) (static_cast<void>(ptr), static_cast<void>(size))
+#endif
+
+template <size_t Bytes, size_t Align = 32>
+class InlineArena {
+    static_assert(Align != 0 && (Align & (Align - 1)) == 0, "Align must be a power of two");
+    static_assert(Bytes > 0, "use a plain ArenaAllocator for zero inline storage");
+    static_assert(Bytes % Align == 0, "Bytes must be a multiple of Align");
+
+public:
+    // Blocks come from aligned_alloc(32) in arena.c, and data follows the header directly
+    static constexpr size_t block_alignment = 32;
+    static_assert(sizeof(ArenaBlock) % block_alignment == 0, "ArenaBlock header must keep block data aligned");
+
+    static constexpr size_t align_up(const size_t size) {
+        return (size + Align - 1) & ~(Align - 1);
+    }
+
+    InlineArena() {
+        init_arena(&overflow, 0);
+        ARENA_HPP_POISON(storage, Bytes);
+    }
+
+    explicit InlineArena(const size_t overflow_capacity) {
+        init_arena(&overflow, overflow_capacity);
+        ARENA_HPP_POISON(storage, Bytes);
+    }
+
+    ~InlineArena() {
+        // The storage is usually on the stack, which must not stay poisoned for whoever reuses it
+        ARENA_HPP_UNPOISON(storage, Bytes);
+        arena_free(&overflow);
+    }
+
+    InlineArena(const InlineArena&) = delete;
+    InlineArena& operator=(const InlineArena&) = delete;
+
+    template <size_t Size>
+    void* alloc() {
+        constexpr size_t size = align_up(Size);
+        static_assert(size >= Size, "allocation size overflows");
+
+        if (__builtin_expect(size <= Bytes - usage, 1)) {
+            void* result = storage + usage;
+            usage += size;
+            ARENA_HPP_UNPOISON(result, Size);
+            return result;
+        }
+
+        return alloc_overflow(size);
+    }
+
+    void* alloc(const size_t size) {
+        if (__builtin_expect(size > SIZE_MAX - (Align - 1), 0)) {
+            return nullptr;
+        }
+
+        const size_t aligned = align_up(size);
+
+        if (__builtin_expect(aligned <= Bytes - usage, 1)) {
+            void* result = storage + usage;
+            usage += aligned;
+            ARENA_HPP_UNPOISON(result, size);
+            return result;
+        }
+
+        return alloc_overflow(aligned);
+    }
+
+    template <typename T, typename... Args>
+    T* make(Args&&... args) {
+        static_assert(alignof(T) <= Align, "type is over-aligned for this arena");
+        static_assert(std::is_trivially_destructible<T>::value, "arena memory is never destructed");
+
+        return new (alloc<sizeof(T)>()) T(std::forward<Args>(args)...);
+    }
+
+    template <typename T>
+    T* make_array(const size_t count) {
+        static_assert(alignof(T) <= Align, "type is over-aligned for this arena");
+        static_assert(std::is_trivially_destructible<T>::value, "arena memory is never destructed");
+
+        if (count > SIZE_MAX / sizeof(T)) {
+            return nullptr;
+        }
+
+        void* data = alloc(sizeof(T) * count);
+        if (!data) {
+            return nullptr;
+        }
+
+        return new (data) T[count];
+    }
+
+    void reset() {
+        ARENA_HPP_POISON(storage, Bytes);
+        usage = 0;
+        arena_reset(&overflow);
+    }
+
+    size_t inline_capacity() const {
+        return Bytes;
+    }
+
+    size_t inline_usage() const {
+        return usage;
+    }
+
+    size_t capacity() const {
+        return Bytes + total_capacity(&overflow);
+    }
+
+    size_t used() const {
+        return usage + total_usage(&overflow);
+    }
+
+private:
+    alignas(Align) unsigned char storage[Bytes];
+    size_t usage = 0;
+    ArenaAllocator overflow;
+
+    __attribute__((noinline)) void* alloc_overflow(const size_t size) {
+        // Block data starts 32 byte aligned and we only hand out multiples of Align, so anything
+        // wider needs padding. Debug redzones can be any size, so always pad under ARENA_DEBUG
+#ifdef ARENA_DEBUG
+        constexpr bool padded = true;
+#else
+        constexpr bool padded = Align > block_alignment;
+#endif
+
+        if constexpr (!padded) {
+            return arena_alloc(&overflow, size);
+        } else {
+            if (size > SIZE_MAX - (Align - 1)) {
+                return nullptr;
+            }
+
+            const uintptr_t raw = reinterpret_cast<uintptr_t>(arena_alloc(&overflow, size + Align - 1));
+            return reinterpret_cast<void*>(align_up(raw));
+        }
+    }
+};
+
+#endif // !ARENA_HPP
@@ -0,0 +1,67 @@
+#include "arena.h"
+#include "test.h"
+
+#include <signal.h>
+#include <stdio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Runs body in a child, so an abort from a tripped canary can be observed rather than fatal
+static int aborts(void (*body)(void)) {
+    const pid_t child = fork();
+    if (child == 0) {
+        freopen("/dev/null", "w", stderr);
+        body();
+        _exit(0);
+    }
+
+    int status = 0;
+    waitpid(child, &status, 0);
+    return WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT;
+}
+
+static void clean_use(void) {
+    ArenaAllocator arena;
+    init_arena(&arena, 0);
+
+    for (int i = 0; i < 2000; i++) {
+        char* data = (char*) arena_alloc(&arena, (size_t) (i % 50));
+        for (int j = 0; j < i % 50; j++) {
+            data[j] = 'x';
+        }
+    }
+
+    arena_reset(&arena);
+    arena_alloc(&arena, 16);
+    arena_free(&arena);
+}
+
+static void overflow_then_reset(void) {
+    ArenaAllocator arena;
+    init_arena(&arena, 0);
+
+    char* data = (char*) arena_alloc(&arena, 40);
+    arena_alloc(&arena, 40);
+    data[40] = 'x';
+
+    arena_reset(&arena);
+}
+
+static void overflow_then_free(void) {
+    ArenaAllocator arena;
+    init_arena(&arena, 0);
+
+    char* data = (char*) arena_alloc(&arena, 13);
+    data[14] = 'x';
+
+    arena_free(&arena);
+}
+
+int main(void) {
+    EXPECT(!aborts(clean_use));
+    EXPECT(aborts(overflow_then_reset));
+    EXPECT(aborts(overflow_then_free));
+
+    printf("canary: %s\n", test_failures ? "FAILED" : "ok");
+    return test_failures != 0;
+}
@@ -0,0 +1,104 @@
+#include "arena.h"
+#include "test.h"
+
+#include <pthread.h>
+#include <sanitizer/asan_interface.h>
+#include <stdio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static void test_redzones(void) {
+    ArenaAllocator arena;
+    init_arena(&arena, 0);
+
+    char* a = arena_alloc(&arena, 40);
+    char* b = arena_alloc(&arena, 40);
+
+    EXPECT(__asan_region_is_poisoned(a, 40) == NULL);
+    EXPECT(__asan_region_is_poisoned(b, 40) == NULL);
+    EXPECT(__asan_address_is_poisoned(a + 40));
+    EXPECT(b >= a + 40 + 32);
+
+    arena_free(&arena);
+}
+
+static void test_use_after_reset(void) {
+    ArenaAllocator arena;
+    init_arena(&arena, 0);
+
+    char* a = arena_alloc(&arena, 64);
+    for (int i = 0; i < 64; i++) {
+        a[i] = 'A';
+    }
+
+    arena_reset(&arena);
+    EXPECT(__asan_address_is_poisoned(a));
+    EXPECT(__asan_address_is_poisoned(a + 63));
+
+    // Reallocating hands the same bytes back, scribbled over with the fill pattern
+    unsigned char* b = (unsigned char*) arena_alloc(&arena, 64);
+    EXPECT((char*) b == a);
+    EXPECT(b[0] == 0xDD && b[63] == 0xDD);
+
+    arena_free(&arena);
+}
+
+static void test_guard_page(void) {
+    ArenaAllocator arena;
+    init_arena(&arena, 0);
+    arena_alloc(&arena, 8);
+
+    const pid_t child = fork();
+    if (child == 0) {
+        freopen("/dev/null", "w", stderr);
+        ArenaBlock* block = arena.start;
+        ((volatile char*) block -> data)[block -> capacity] = 1;
+        _exit(0);
+    }
+
+    int status = 0;
+    waitpid(child, &status, 0);
+    EXPECT(!WIFEXITED(status) || WEXITSTATUS(status) != 0);
+
+    arena_free(&arena);
+}
+
+static pthread_key_t late_key;
+static int late_allocated = 0;
+
+static void late_destructor(void* data) {
+    (void) data;
+
+    // Runs after the thread arena's own destructor, ASan catches it if that left a dangling arena
+    const char* late = arena_strdup(arena_thread_local(), "late");
+    late_allocated = late[0] == 'l';
+}
+
+static void* exiting_worker(void* data) {
+    arena_strdup(arena_thread_local(), "early");
+    pthread_setspecific(late_key, data);
+    return NULL;
+}
+
+static void test_thread_exit(void) {
+    // The arena key has to exist before ours so its destructor runs first
+    arena_thread_local();
+    EXPECT(pthread_key_create(&late_key, late_destructor) == 0);
+
+    pthread_t worker;
+    EXPECT(pthread_create(&worker, NULL, exiting_worker, &late_key) == 0);
+    EXPECT(pthread_join(worker, NULL) == 0);
+    EXPECT(late_allocated);
+
+    pthread_key_delete(late_key);
+}
+
+int main(void) {
+    test_redzones();
+    test_use_after_reset();
+    test_guard_page();
+    test_thread_exit();
+
+    printf("debug: %s\n", test_failures ? "FAILED" : "ok");
+    return test_failures != 0;
+}
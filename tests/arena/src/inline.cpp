@@ -0,0 +1,95 @@
+#include "arena.hpp"
+#include "test.h"
+
+#include <cstdint>
+#include <cstdio>
+
+#ifdef ARENA_DEBUG
+#include <sanitizer/asan_interface.h>
+#endif
+
+struct Pair {
+    int key;
+    double value;
+
+    Pair(int k, double v) : key(k), value(v) {}
+};
+
+struct alignas(64) Wide {
+    char bytes[64];
+};
+
+static void test_inline_to_overflow() {
+    InlineArena<256> arena;
+    const uintptr_t begin = (uintptr_t) &arena;
+    const uintptr_t end = begin + sizeof(arena);
+
+    // 256 inline bytes hold eight 32 byte slots, the ninth has to spill into a block
+    for (int i = 0; i < 8; i++) {
+        Pair* pair = arena.make<Pair>(i, i * 0.5);
+        EXPECT((uintptr_t) pair >= begin && (uintptr_t) pair < end);
+        EXPECT((uintptr_t) pair % 32 == 0);
+        EXPECT(pair -> key == i);
+    }
+
+    EXPECT(arena.inline_usage() == 256);
+    EXPECT(arena.capacity() == 256);
+
+    Pair* spilled = arena.make<Pair>(8, 4.0);
+    EXPECT((uintptr_t) spilled < begin || (uintptr_t) spilled >= end);
+    EXPECT((uintptr_t) spilled % 32 == 0);
+    EXPECT(arena.capacity() > 256);
+
+    for (int i = 0; i < 100; i++) {
+        EXPECT((uintptr_t) arena.alloc(24) % 32 == 0);
+    }
+
+    arena.reset();
+    EXPECT(arena.inline_usage() == 0);
+    // Storage is the first member, so a fresh arena starts handing out memory at its own address
+    EXPECT((uintptr_t) arena.make<Pair>(0, 0.0) == begin);
+}
+
+static void test_wide_alignment() {
+    InlineArena<128, 64> arena;
+
+    for (int i = 0; i < 50; i++) {
+        EXPECT((uintptr_t) arena.make<Wide>() % 64 == 0);
+        EXPECT((uintptr_t) arena.alloc(1) % 64 == 0);
+    }
+}
+
+static void test_size_overflow() {
+    InlineArena<256> arena;
+
+    EXPECT(arena.alloc(SIZE_MAX) == nullptr);
+    EXPECT(arena.alloc(SIZE_MAX - 3) == nullptr);
+    EXPECT(arena.make_array<double>(SIZE_MAX / 4) == nullptr);
+    EXPECT(arena.inline_usage() == 0);
+}
+
+#ifdef ARENA_DEBUG
+static void test_poisoning() {
+    InlineArena<256> arena;
+
+    char* data = (char*) arena.alloc(40);
+    EXPECT(__asan_region_is_poisoned(data, 40) == nullptr);
+    EXPECT(__asan_address_is_poisoned(data + 40));
+
+    arena.reset();
+    EXPECT(__asan_address_is_poisoned(data));
+}
+#endif
+
+int main() {
+    test_inline_to_overflow();
+    test_wide_alignment();
+    test_size_overflow();
+
+#ifdef ARENA_DEBUG
+    test_poisoning();
+#endif
+
+    std::printf("inline: %s\n", test_failures ? "FAILED" : "ok");
+    return test_failures != 0;
+}
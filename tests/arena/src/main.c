@@ -1,11 +1,260 @@
 #include "arena.h"
+#include "test.h"
 
+#include <dirent.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 #define SIZE 512
 
+#define MPOL_F_NODE (1 << 0)
+#define MPOL_F_ADDR (1 << 1)
+
 static ArenaAllocator arena = {0};
 
+static int pages_resident(void* ptr, const size_t size) {
+    const size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    const uintptr_t begin = (uintptr_t) ptr & ~(page - 1);
+    const size_t pages = ((uintptr_t) ptr + size - begin + page - 1) / page;
+    unsigned char residency[1024];
+
+    if (pages > sizeof(residency) || mincore((void*) begin, pages * page, residency) != 0) {
+        return 0;
+    }
+
+    for (size_t i = 0; i < pages; i++) {
+        if (!(residency[i] & 1)) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static void test_prefault(void) {
+    const ArenaOptions options = { .numa_node = ARENA_NUMA_ANY, .flags = ARENA_PREFAULT };
+    ArenaAllocator prefaulted;
+    init_arena_with_options(&prefaulted, 0, &options);
+
+    arena_alloc(&prefaulted, 8);
+    ArenaBlock* block = prefaulted.start;
+    EXPECT(block -> mapped_size != 0);
+    EXPECT(pages_resident(block -> data, block -> capacity));
+
+    arena_free(&prefaulted);
+}
+
+static void test_bound_node(void) {
+    const ArenaOptions options = { .numa_node = 0, .flags = ARENA_PREFAULT };
+    ArenaAllocator bound;
+    init_arena_with_options(&bound, 0, &options);
+
+    // Single node systems drop the binding, otherwise every page has to land on node 0
+    EXPECT(bound.options.numa_node == 0 || bound.options.numa_node == ARENA_NUMA_ANY);
+
+    char* data = (char*) arena_alloc(&bound, 4096);
+    data[0] = 1;
+
+    if (bound.options.numa_node == 0) {
+        int node = -1;
+        EXPECT(syscall(SYS_get_mempolicy, &node, NULL, 0, data, MPOL_F_NODE | MPOL_F_ADDR) == 0);
+        EXPECT(node == 0);
+    }
+
+    arena_free(&bound);
+
+    const ArenaOptions local = { .numa_node = ARENA_NUMA_LOCAL, .flags = 0 };
+    init_arena_with_options(&bound, 0, &local);
+    EXPECT(bound.options.numa_node != ARENA_NUMA_LOCAL);
+    arena_free(&bound);
+}
+
+static void test_preallocate(void) {
+    const ArenaOptions options = { .numa_node = ARENA_NUMA_ANY, .flags = ARENA_PREALLOCATE };
+    ArenaAllocator preallocated;
+    init_arena_with_options(&preallocated, 0, &options);
+
+    for (int i = 0; i < 256; i++) {
+        char* data = (char*) arena_alloc(&preallocated, 4096);
+        arena_memset(data, i, 4096);
+    }
+
+    EXPECT(total_usage(&preallocated) == 256 * 4096);
+    EXPECT(preallocated.preallocator != NULL);
+
+    arena_free(&preallocated);
+    EXPECT(preallocated.preallocator == NULL);
+}
+
+typedef struct Node {
+    struct Node* next;
+    struct Node* first;
+    long value;
+} Node;
+
+#define SNAPSHOT_PATH "build/snapshot.bin"
+#define SNAPSHOT_NODES 2000
+
+static int snapshot_matches(const Node* first) {
+    if (!first || first -> value != 0) {
+        return 0;
+    }
+
+    long count = 0;
+    for (const Node* node = first; node != NULL; node = node -> next) {
+        if (node -> value != count || node -> first != first) {
+            return 0;
+        }
+        count++;
+    }
+
+    return count == SNAPSHOT_NODES;
+}
+
+// Counts leftover "<prefix>XXXXXX" temp files of a snapshot
+static int temp_files(const char* directory, const char* prefix) {
+    DIR* dir = opendir(directory);
+    if (!dir) {
+        return -1;
+    }
+
+    int count = 0;
+    const size_t length = strlen(prefix);
+    for (struct dirent* entry = readdir(dir); entry != NULL; entry = readdir(dir)) {
+        if (strncmp(entry -> d_name, prefix, length) == 0 && strlen(entry -> d_name) == length + 6) {
+            count++;
+        }
+    }
+
+    closedir(dir);
+    return count;
+}
+
+static void test_snapshot(void) {
+    ArenaAllocator source;
+    init_arena(&source, 64);
+
+    static void** slots[2 * SNAPSHOT_NODES];
+    size_t slot_count = 0;
+    Node* first = NULL;
+    Node* previous = NULL;
+
+    // Odd sized filler spreads the nodes over many blocks at uneven offsets
+    for (long i = 0; i < SNAPSHOT_NODES; i++) {
+        Node* node = (Node*) arena_alloc(&source, sizeof(Node));
+        arena_alloc(&source, (size_t) (i % 5) * 8);
+
+        first = first ? first : node;
+        node -> next = NULL;
+        node -> first = first;
+        node -> value = i;
+
+        if (previous) {
+            previous -> next = node;
+        }
+        previous = node;
+
+        slots[slot_count++] = (void**) &node -> next;
+        slots[slot_count++] = (void**) &node -> first;
+    }
+
+    EXPECT(arena_snapshot(&source, SNAPSHOT_PATH, slots, slot_count) == 0);
+
+    ArenaAllocator restored;
+    init_arena(&restored, 0);
+    Node* copy = (Node*) arena_restore(&restored, SNAPSHOT_PATH);
+    EXPECT(snapshot_matches(copy));
+    EXPECT(restored.start != NULL && restored.start -> capacity == restored.start -> usage);
+    EXPECT(arena_strdup(&restored, "after") != NULL);
+    arena_free(&restored);
+
+    init_arena(&restored, 0);
+    copy = (Node*) arena_restore_mapped(&restored, SNAPSHOT_PATH);
+    EXPECT(snapshot_matches(copy));
+    arena_free(&restored);
+
+    // A failed snapshot must leave the previous one untouched
+    struct stat before;
+    struct stat after;
+    long outside = 0;
+    void** bad_slot[1] = { (void**) &outside };
+    outside = (long) &outside;
+
+    EXPECT(stat(SNAPSHOT_PATH, &before) == 0);
+    EXPECT(arena_snapshot(&source, SNAPSHOT_PATH, bad_slot, 1) == -1);
+    EXPECT(arena_snapshot(&source, "build", slots, slot_count) == -1);
+    EXPECT(stat(SNAPSHOT_PATH, &after) == 0 && after.st_size == before.st_size);
+    EXPECT(temp_files("build", "snapshot.bin.") == 0);
+    EXPECT(temp_files(".", "build.") == 0);
+
+    init_arena(&restored, 0);
+    EXPECT(snapshot_matches((Node*) arena_restore(&restored, SNAPSHOT_PATH)));
+    arena_free(&restored);
+
+    arena_free(&source);
+}
+
+#define STAGE_RESULTS 1000
+
+static void* produce_stage(void* data) {
+    ArenaAllocator* result = (ArenaAllocator*) data;
+
+    // Scratch from earlier, larger tasks is reset away, only the last task's output is handed on
+    for (int task = 0; task < 10; task++) {
+        ArenaAllocator* scratch = arena_thread_begin();
+
+        for (long i = 0; i < (10 - task) * STAGE_RESULTS; i++) {
+            long* value = (long*) arena_alloc(scratch, sizeof(long));
+            *value = task * STAGE_RESULTS + i;
+        }
+    }
+
+    ArenaAllocator* scratch = arena_thread_local();
+    arena_handoff(result, scratch);
+
+    // The blocks the last task never reached stay with the thread for its next task
+    const size_t spare = total_capacity(scratch);
+    if (spare == 0 || total_usage(scratch) != 0) {
+        return data;
+    }
+
+    scratch = arena_thread_begin();
+    for (long i = 0; i < STAGE_RESULTS; i++) {
+        arena_alloc(scratch, sizeof(long));
+    }
+
+    return total_capacity(scratch) == spare ? NULL : data;
+}
+
+static void test_handoff(void) {
+    ArenaAllocator result;
+    init_arena(&result, 0);
+
+    pthread_t producer;
+    void* failed = NULL;
+    EXPECT(pthread_create(&producer, NULL, produce_stage, &result) == 0);
+    EXPECT(pthread_join(producer, &failed) == 0 && failed == NULL);
+
+    EXPECT(total_usage(&result) == STAGE_RESULTS * sizeof(long));
+    EXPECT(*(long*) result.start -> data == 9 * STAGE_RESULTS);
+
+    ArenaAllocator sink;
+    init_arena(&sink, 0);
+    arena_strdup(&sink, "sink");
+    const size_t before = total_usage(&sink);
+
+    arena_handoff(&sink, &result);
+    EXPECT(result.start == NULL && result.end == NULL);
+    EXPECT(total_usage(&sink) == before + STAGE_RESULTS * sizeof(long));
+
+    arena_free(&sink);
+}
+
 int main(void) {
     init_arena(&arena, 512);
 
@@ -14,4 +263,13 @@ int main(void) {
     s[SIZE - 1] = 0;
 
     printf("%s\n", s);
+
+    test_prefault();
+    test_bound_node();
+    test_preallocate();
+    test_snapshot();
+    test_handoff();
+
+    printf("main: %s\n", test_failures ? "FAILED" : "ok");
+    return test_failures != 0;
 }